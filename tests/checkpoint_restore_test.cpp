@@ -0,0 +1,95 @@
+// restore() into a demuxer that already holds stream state: the restored
+// demuxer must re-checkpoint to the same blob and emit the same frames as
+// the demuxer the checkpoint came from.
+#include "tests/tsdemux_test_env.h"
+
+struct Emitted {
+    uint16_t pid;
+    uint64_t pts;
+    std::vector<uint8_t> data;
+    
+    bool operator==(const Emitted& other) const {
+        return pid == other.pid && pts == other.pts && data == other.data;
+    }
+};
+
+static void record(VLCTSDemuxer& demuxer, std::vector<Emitted>& frames) {
+    demuxer.setVideoCallback([&frames](uint16_t pid, const uint8_t* data, size_t size, VLCPESHeader& header) {
+        frames.push_back({ pid, header.pts, std::vector<uint8_t>(data, data + size) });
+    });
+}
+
+// A slice with no AUD in front stays open until the next PES starts
+static std::vector<uint8_t> openSlice(size_t bytes) {
+    std::vector<uint8_t> au = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x88 };
+    for (size_t i = 0; i < bytes; i++) {
+        au.push_back((uint8_t)(0x10 + i % 0xE0));
+    }
+    return au;
+}
+
+static int roundTrip(bool sourceHasFrame) {
+    TestTSWriter prefix;
+    prefix.writePSI();
+    if (sourceHasFrame) {
+        prefix.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000, openSlice(800));
+    }
+    
+    std::vector<Emitted> sourceFrames;
+    VLCTSDemuxer source;
+    record(source, sourceFrames);
+    source.demuxPackets(prefix.out.data(), prefix.packets());
+    std::vector<uint8_t> blob;
+    source.checkpoint(blob);
+    
+    // The target is mid-frame on the same PID, with different timing
+    TestTSWriter dirty;
+    dirty.writePSI();
+    dirty.writePES(TestTSWriter::VIDEO_PID, 0xE0, 450000, openSlice(1500));
+    dirty.writePES(TestTSWriter::AUDIO_PID, 0xC0, 450000, TestTSWriter::adtsFrame(200));
+    std::vector<Emitted> targetFrames;
+    VLCTSDemuxer target;
+    record(target, targetFrames);
+    target.demuxPackets(dirty.out.data(), dirty.packets());
+    TEST_CHECK(target.restore(blob.data(), blob.size()));
+    
+    std::vector<uint8_t> again;
+    target.checkpoint(again);
+    TEST_CHECK(again.size() == blob.size());
+    TEST_CHECK(again == blob);
+    
+    // Frame accounting follows the restored frames, not the discarded one
+    TEST_CHECK(target.getPIDMemory(TestTSWriter::VIDEO_PID).bytes ==
+               source.getPIDMemory(TestTSWriter::VIDEO_PID).bytes);
+    TEST_CHECK(target.getPIDMemory(TestTSWriter::AUDIO_PID).bytes == 0);
+    TEST_CHECK(target.getMemoryStats().bufferedBytes == source.getMemoryStats().bufferedBytes);
+    
+    // Continue the source stream through both
+    TestTSWriter rest = prefix;
+    rest.out.clear();
+    for (int i = 1; i <= 10; i++) {
+        rest.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                      TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 5 == 0, 400));
+    }
+    sourceFrames.clear();
+    targetFrames.clear();
+    source.demuxPackets(rest.out.data(), rest.packets());
+    target.demuxPackets(rest.out.data(), rest.packets());
+    source.flushPendingFrames();
+    target.flushPendingFrames();
+    TEST_CHECK(sourceFrames.size() >= 10);
+    TEST_CHECK(targetFrames == sourceFrames);
+    TEST_CHECK(target.getMemoryStats().bufferedBytes == source.getMemoryStats().bufferedBytes);
+    
+    source.checkpoint(blob);
+    target.checkpoint(again);
+    TEST_CHECK(again == blob);
+    return 0;
+}
+
+int main() {
+    if (roundTrip(false) != 0) return 1;     // PSI only
+    if (roundTrip(true) != 0) return 1;      // Frame in progress
+    printf("checkpoint_restore_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,192 @@
+// Codec configuration records: the avcC High profile extension and the
+// hvcC built from cached HEVC VPS/SPS/PPS.
+#include "tests/tsdemux_test_env.h"
+
+// Writes an RBSP bit by bit; nal() adds the trailing bits and emulation
+// prevention bytes
+class BitWriter {
+public:
+    std::vector<uint8_t> bytes;
+    
+    void bits(uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--) {
+            if (mBit == 0) bytes.push_back(0);
+            if (value & (1u << i)) bytes.back() |= (uint8_t)(0x80 >> mBit);
+            mBit = (mBit + 1) & 7;
+        }
+    }
+    
+    void ue(uint32_t value) {
+        uint32_t coded = value + 1;
+        int length = 0;
+        while ((coded >> length) > 1) length++;
+        bits(0, length);
+        bits(coded, length + 1);
+    }
+    
+    std::vector<uint8_t> nal() {
+        bits(1, 1);
+        while (mBit != 0) bits(0, 1);
+        std::vector<uint8_t> escaped;
+        int zeros = 0;
+        for (uint8_t byte : bytes) {
+            if (zeros >= 2 && byte <= 0x03) {
+                escaped.push_back(0x03);
+                zeros = 0;
+            }
+            escaped.push_back(byte);
+            zeros = byte == 0x00 ? zeros + 1 : 0;
+        }
+        return escaped;
+    }
+
+private:
+    int mBit = 0;
+};
+
+// 320x240 High 10 (profile_idc 110), 4:2:0, 10-bit luma and chroma
+static std::vector<uint8_t> high10SPS() {
+    BitWriter w;
+    w.bits(0x67, 8);
+    w.bits(110, 8);         // profile_idc
+    w.bits(0, 8);           // constraint flags
+    w.bits(30, 8);          // level_idc
+    w.ue(0);                // seq_parameter_set_id
+    w.ue(1);                // chroma_format_idc
+    w.ue(2);                // bit_depth_luma_minus8
+    w.ue(2);                // bit_depth_chroma_minus8
+    w.bits(0, 1);           // qpprime_y_zero_transform_bypass_flag
+    w.bits(0, 1);           // seq_scaling_matrix_present_flag
+    w.ue(0);                // log2_max_frame_num_minus4
+    w.ue(0);                // pic_order_cnt_type
+    w.ue(0);                // log2_max_pic_order_cnt_lsb_minus4
+    w.ue(1);                // max_num_ref_frames
+    w.bits(0, 1);           // gaps_in_frame_num_value_allowed_flag
+    w.ue(19);               // pic_width_in_mbs_minus1
+    w.ue(14);               // pic_height_in_map_units_minus1
+    w.bits(1, 1);           // frame_mbs_only_flag
+    w.bits(1, 1);           // direct_8x8_inference_flag
+    w.bits(0, 1);           // frame_cropping_flag
+    w.bits(0, 1);           // vui_parameters_present_flag
+    return w.nal();
+}
+
+// 320x240 Main 10, level 3.1, 4:2:0; profile_tier_level needs emulation
+// prevention
+static const uint8_t HEVC_PTL[12] = { 0x02, 0x20, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5D };
+
+static std::vector<uint8_t> hevcSPS() {
+    BitWriter w;
+    w.bits(33 << 1, 8);     // nal_unit_type 33
+    w.bits(1, 8);           // nuh_temporal_id_plus1
+    w.bits(0, 4);           // sps_video_parameter_set_id
+    w.bits(0, 3);           // sps_max_sub_layers_minus1
+    w.bits(1, 1);           // sps_temporal_id_nesting_flag
+    for (uint8_t byte : HEVC_PTL) w.bits(byte, 8);
+    w.ue(0);                // sps_seq_parameter_set_id
+    w.ue(1);                // chroma_format_idc
+    w.ue(320);              // pic_width_in_luma_samples
+    w.ue(240);              // pic_height_in_luma_samples
+    w.bits(0, 1);           // conformance_window_flag
+    w.ue(2);                // bit_depth_luma_minus8
+    w.ue(2);                // bit_depth_chroma_minus8
+    return w.nal();
+}
+
+static std::vector<uint8_t> annexB(const std::vector<std::vector<uint8_t>>& nals) {
+    std::vector<uint8_t> au;
+    for (const auto& nal : nals) {
+        au.insert(au.end(), { 0x00, 0x00, 0x00, 0x01 });
+        au.insert(au.end(), nal.begin(), nal.end());
+    }
+    return au;
+}
+
+static std::vector<std::vector<uint8_t>> records;
+
+static void demux(TestTSWriter& ts) {
+    VLCTSDemuxer demuxer;
+    demuxer.setVideoCallback([](uint16_t, const uint8_t*, size_t, VLCPESHeader&) {});
+    demuxer.setCodecConfigCallback([](uint16_t, const uint8_t* record, size_t size) {
+        records.emplace_back(record, record + size);
+    });
+    demuxer.demuxPackets(ts.out.data(), ts.packets());
+    demuxer.flushPendingFrames();
+}
+
+static int highProfileAVCC() {
+    std::vector<uint8_t> sps = high10SPS();
+    std::vector<uint8_t> pps = TestTSWriter::pps();
+    TestTSWriter ts;
+    ts.writePSI();
+    for (int i = 0; i < 3; i++) {
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                    TestTSWriter::accessUnit({ sps, pps }, i == 0, 400));
+    }
+    records.clear();
+    demux(ts);
+    
+    TEST_CHECK(records.size() == 1);
+    const std::vector<uint8_t>& avcC = records[0];
+    TEST_CHECK(avcC.size() == 11 + sps.size() + pps.size() + 4);
+    TEST_CHECK(avcC[1] == 110);
+    TEST_CHECK(std::equal(sps.begin(), sps.end(), avcC.begin() + 8));
+    const uint8_t* extension = avcC.data() + avcC.size() - 4;
+    TEST_CHECK(extension[0] == (0xFC | 1));     // 4:2:0
+    TEST_CHECK(extension[1] == (0xF8 | 2));     // 10-bit luma
+    TEST_CHECK(extension[2] == (0xF8 | 2));     // 10-bit chroma
+    TEST_CHECK(extension[3] == 0);
+    
+    // Baseline keeps the short record
+    std::vector<uint8_t> baseline;
+    TEST_CHECK(VLCTSDemuxer::buildCodecConfig(TestTSWriter::sps().data(), TestTSWriter::sps().size(),
+                                              pps.data(), pps.size(), baseline));
+    TEST_CHECK(baseline.size() == 11 + TestTSWriter::sps().size() + pps.size());
+    return 0;
+}
+
+static int hevcHVCC() {
+    std::vector<uint8_t> vps = { 0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF, 0x02, 0x20, 0x00, 0x00, 0x03, 0x00, 0x90 };
+    std::vector<uint8_t> sps = hevcSPS();
+    std::vector<uint8_t> pps = { 0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40 };
+    std::vector<uint8_t> slice = { 0x26, 0x01, 0xAF };     // IDR_W_RADL
+    slice.resize(400, 0x5A);
+    TestTSWriter ts;
+    ts.writePSI(VLC_STREAM_TYPE_VIDEO_HEVC);
+    for (int i = 0; i < 3; i++) {
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                    annexB({ { 0x46, 0x01, 0x50 }, vps, sps, pps, slice }));
+    }
+    records.clear();
+    demux(ts);
+    
+    TEST_CHECK(records.size() == 1);
+    const std::vector<uint8_t>& hvcC = records[0];
+    TEST_CHECK(hvcC.size() == 23 + 3 * 5 + vps.size() + sps.size() + pps.size());
+    TEST_CHECK(hvcC[0] == 1);
+    TEST_CHECK(memcmp(hvcC.data() + 1, HEVC_PTL, sizeof(HEVC_PTL)) == 0);
+    TEST_CHECK(hvcC[16] == (0xFC | 1));
+    TEST_CHECK(hvcC[17] == (0xF8 | 2));
+    TEST_CHECK(hvcC[18] == (0xF8 | 2));
+    TEST_CHECK(hvcC[21] == (0x08 | 0x04 | 0x03));  // One temporal layer, nested, 4-byte lengths
+    TEST_CHECK(hvcC[22] == 3);
+    
+    size_t pos = 23;
+    const std::vector<uint8_t>* sets[3] = { &vps, &sps, &pps };
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK(hvcC[pos] == (0x80 | (32 + i)));
+        TEST_CHECK(hvcC[pos + 1] == 0 && hvcC[pos + 2] == 1);
+        size_t length = (hvcC[pos + 3] << 8) | hvcC[pos + 4];
+        TEST_CHECK(length == sets[i]->size());
+        TEST_CHECK(std::equal(sets[i]->begin(), sets[i]->end(), hvcC.begin() + pos + 5));
+        pos += 5 + length;
+    }
+    return 0;
+}
+
+int main() {
+    if (highProfileAVCC() != 0) return 1;
+    if (hevcHVCC() != 0) return 1;
+    printf("codec_config_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,34 @@
+// demuxPackets() after a lost sync byte: the bad packet sends the batch
+// through the byte path, which must drain everything it holds so later
+// batches are parsed in place again. The bad packet is a continuation, so
+// every frame still arrives: 2999 of 3000 while the last one is open.
+#include "tests/tsdemux_test_env.h"
+
+int main() {
+    const int units = 3000;
+    const size_t batch = 448;
+    
+    TestTSWriter ts;
+    ts.writePSI();
+    for (int i = 0; i < units; i++) {
+        ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, 90000 + i * 1920, TestTSWriter::adtsFrame(300));
+    }
+    ts.out[7 * VLC_TS_PACKET_SIZE] = 0x00;     // In the first batch
+    
+    VLCTSDemuxer demuxer;
+    size_t frames = 0;
+    auto count = [&frames](uint16_t, const uint8_t*, size_t, VLCPESHeader&) { frames++; };
+    demuxer.setAudioCallback(count);
+    demuxer.setVideoCallback(count);
+    
+    size_t packets = ts.packets();
+    for (size_t i = 0; i < packets; i += batch) {
+        demuxer.demuxPackets(ts.out.data() + i * VLC_TS_PACKET_SIZE, std::min(batch, packets - i));
+    }
+    TEST_CHECK(frames == units - 1);
+    demuxer.flushPendingFrames();
+    TEST_CHECK(frames == units);
+    
+    printf("demux_packets_resync_test: ok (%zu of %d frames)\n", frames, units);
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Throughput per core of VLCTSDemuxService across worker counts. Every
+// packet is demuxed exactly once, every frame arrives, and the busy-time
+// rate is consistent with the wall-clock rate.
+#include "tests/tsdemux_test_env.h"
+
+static const size_t CHANNELS = 16;
+static const int UNITS = 600;
+
+struct Result {
+    double perCore = 0.0;
+    double wallRate = 0.0;
+};
+
+static int measure(const TestTSWriter& ts, size_t workers, Result& result) {
+    VLCTSDemuxService service(workers, 64, 5, false);
+    std::atomic<uint64_t> frames(0);
+    std::vector<VLCTSDemuxService::Channel*> channels;
+    for (size_t i = 0; i < CHANNELS; i++) {
+        channels.push_back(service.addChannel([&frames](VLCTSDemuxer& demuxer) {
+            demuxer.setVideoCallback([&frames](uint16_t, const uint8_t*, size_t, VLCPESHeader&) {
+                frames.fetch_add(1, std::memory_order_relaxed);
+            });
+        }));
+    }
+    TEST_CHECK(service.start());
+    
+    // Input arrives in datagram-sized pieces, round robin over the channels
+    auto begin = std::chrono::steady_clock::now();
+    const size_t piece = 7 * VLC_TS_PACKET_SIZE;
+    for (size_t offset = 0; offset < ts.out.size(); offset += piece) {
+        size_t size = std::min(piece, ts.out.size() - offset);
+        for (auto* channel : channels) {
+            service.submit(channel, ts.out.data() + offset, size);
+        }
+    }
+    service.stop(true);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    
+    uint64_t packets = 0;
+    uint64_t busyNs = 0;
+    for (size_t i = 0; i < service.workerCount(); i++) {
+        packets += service.workerStats(i).packets.load();
+        busyNs += service.workerStats(i).busyNs.load();
+    }
+    TEST_CHECK(packets == CHANNELS * ts.packets());
+    for (auto* channel : channels) {
+        TEST_CHECK(channel->packetCount() == ts.packets());
+        TEST_CHECK(channel->droppedByteCount() == 0);
+    }
+    TEST_CHECK(frames.load() == CHANNELS * UNITS);
+    
+    result.perCore = service.throughputPerCore();
+    result.wallRate = wall > 0 ? (double)packets / wall : 0.0;
+    TEST_CHECK(std::isfinite(result.perCore) && result.perCore > 0.0);
+    TEST_CHECK(busyNs > 0);
+    
+    // Workers cannot be busy for longer than they exist
+    TEST_CHECK((double)busyNs / 1e9 <= wall * workers * 1.05 + 0.01);
+    TEST_CHECK(result.wallRate <= result.perCore * workers * 1.05);
+    return 0;
+}
+
+int main() {
+    TestTSWriter ts;
+    ts.writePSI();
+    for (int i = 0; i < UNITS; i++) {
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                    TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 30 == 0, 1200));
+    }
+    
+    for (size_t workers : { 1, 2, 4 }) {
+        Result result;
+        if (measure(ts, workers, result) != 0) return 1;
+        printf("demux_service_throughput_test: %zu workers: %.0f packets/s per busy core, %.0f packets/s wall\n",
+               workers, result.perCore, result.wallRate);
+    }
+    printf("demux_service_throughput_test: ok\n");
+    return 0;
+}
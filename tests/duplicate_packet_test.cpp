@@ -0,0 +1,51 @@
+// A TS packet repeated with the same CC is a duplicate (ISO 13818-1): its
+// payload is dropped and no continuity error is counted, through demux()
+// and demuxPackets() alike. A 480-byte frame must not grow to 664 bytes.
+#include "tests/tsdemux_test_env.h"
+
+static const size_t FRAME_BYTES = 480;
+
+static int check(const std::vector<uint8_t>& ts, bool packets, size_t frames) {
+    VLCTSDemuxer demuxer;
+    std::vector<size_t> sizes;
+    auto record = [&sizes](uint16_t, const uint8_t*, size_t size, VLCPESHeader&) { sizes.push_back(size); };
+    demuxer.setVideoCallback(record);
+    demuxer.setAudioCallback(record);
+    if (packets) {
+        demuxer.demuxPackets(ts.data(), ts.size() / VLC_TS_PACKET_SIZE);
+    } else {
+        demuxer.demux(ts.data(), ts.size());
+    }
+    demuxer.flushPendingFrames();
+    
+    TEST_CHECK(sizes.size() == frames);
+    for (size_t size : sizes) {
+        TEST_CHECK(size == FRAME_BYTES);
+    }
+    TEST_CHECK(demuxer.getContinuityErrors() == 0);
+    return 0;
+}
+
+int main() {
+    const int units = 3;
+    
+    TestTSWriter ts;
+    ts.writePSI();
+    size_t first = ts.packets();
+    for (int i = 0; i < units; i++) {
+        ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, 90000 + i * 1920, TestTSWriter::adtsFrame(FRAME_BYTES));
+    }
+    
+    // Repeat the first frame's continuation packet right after itself
+    std::vector<uint8_t> duplicated = ts.out;
+    auto copy = ts.out.begin() + (first + 1) * VLC_TS_PACKET_SIZE;
+    duplicated.insert(duplicated.begin() + (first + 2) * VLC_TS_PACKET_SIZE, copy, copy + VLC_TS_PACKET_SIZE);
+    
+    for (bool packets : { false, true }) {
+        if (check(ts.out, packets, units) != 0) return 1;
+        if (check(duplicated, packets, units) != 0) return 1;
+    }
+    
+    printf("duplicate_packet_test: ok\n");
+    return 0;
+}
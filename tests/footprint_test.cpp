@@ -0,0 +1,44 @@
+// Per-instance heap cost of a low-footprint VLCTSDemuxer, against the table
+// at VLCTSDemuxer::setLowFootprint().
+#include "tests/tsdemux_test_env.h"
+
+int main() {
+    VLCTSCountingResource counting;
+    std::unique_ptr<VLCTSDemuxer> demuxer(new VLCTSDemuxer(&counting));
+    demuxer->setLowFootprint(true);
+    
+    // Fresh: ~1.6KB, of which 1KB is the discontinuity bitmap
+    size_t fresh = counting.bytesInUse();
+    TEST_CHECK(fresh >= 1024);
+    TEST_CHECK(fresh <= 2048);
+    
+    // One A/V program
+    TestTSWriter ts;
+    ts.writePSI();
+    for (int i = 0; i < 20; i++) {
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                    TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 10 == 0, 400));
+        ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, 90000 + i * 1920, TestTSWriter::adtsFrame(200));
+    }
+    demuxer->demuxPackets(ts.out.data(), ts.packets());
+    size_t running = counting.bytesInUse();
+    TEST_CHECK(running > fresh);
+    
+    // Nothing open and trimmed: back to the program cost, ~1.5KB
+    demuxer->flushPendingFrames();
+    demuxer->trimIdleBuffers();
+    size_t trimmed = counting.bytesInUse();
+    TEST_CHECK(trimmed < running);
+    TEST_CHECK(trimmed - fresh <= 2048);
+    TEST_CHECK(demuxer->memoryFootprint() >= trimmed);
+    
+    // Trimming again has nothing left to release
+    TEST_CHECK(demuxer->trimIdleBuffers() == 0);
+    TEST_CHECK(counting.bytesInUse() == trimmed);
+    
+    demuxer.reset();
+    TEST_CHECK(counting.bytesInUse() == 0);
+    
+    printf("footprint_test: ok (fresh %zu, program %zu bytes)\n", fresh, trimmed - fresh);
+    return 0;
+}
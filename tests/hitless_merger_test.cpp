@@ -0,0 +1,111 @@
+// VLCTSHitlessMerger: an RTP copy the depacketizer rejects must not claim
+// its sequence number, so the good copy from the other path is still used
+// and nothing is reported lost. On raw TS, a gap fill drains everything
+// held behind the gap at once, including a packet that repeats one already
+// forwarded, without waiting for maxDelayMs or reporting a loss.
+#include "tests/tsdemux_test_env.h"
+
+static const size_t PACKETS_PER_DATAGRAM = 7;
+
+static std::vector<uint8_t> datagram(uint16_t seq, const uint8_t* packets) {
+    std::vector<uint8_t> rtp = { 0x80, 33, (uint8_t)(seq >> 8), (uint8_t)seq,
+                                 0x00, 0x00, 0x00, 0x00, 0x12, 0x34, 0x56, 0x78 };
+    rtp.insert(rtp.end(), packets, packets + PACKETS_PER_DATAGRAM * VLC_TS_PACKET_SIZE);
+    return rtp;
+}
+
+static int corruptRTPCopy() {
+    TestTSWriter ts;
+    ts.writePSI();
+    for (int i = 0; i < 20; i++) {
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                    TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 10 == 0, 900));
+    }
+    while (ts.packets() % PACKETS_PER_DATAGRAM) ts.writeNull();
+    
+    VLCTSHitlessMerger merger;
+    std::vector<uint8_t> out;
+    uint64_t lost = 0;
+    merger.setPacketSink([&out](const uint8_t* packets, size_t count) {
+        out.insert(out.end(), packets, packets + count * VLC_TS_PACKET_SIZE);
+    });
+    merger.setLossSink([&lost](uint64_t packets) { lost += packets; });
+    
+    // Path A's copy of one datagram carries trailing garbage past the slot
+    // size; path B's copy follows and must fill the sequence number
+    size_t datagrams = ts.packets() / PACKETS_PER_DATAGRAM;
+    size_t corrupt = datagrams / 2;
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < datagrams; i++) {
+        std::vector<uint8_t> good = datagram((uint16_t)i, ts.out.data() + i * PACKETS_PER_DATAGRAM * VLC_TS_PACKET_SIZE);
+        if (i == corrupt) {
+            std::vector<uint8_t> bad = good;
+            bad.insert(bad.end(), 64, 0xA5);
+            TEST_CHECK(!merger.pushRTP(0, bad.data(), bad.size(), now));
+        } else {
+            TEST_CHECK(merger.pushRTP(0, good.data(), good.size(), now));
+        }
+        TEST_CHECK(merger.pushRTP(1, good.data(), good.size(), now));
+    }
+    merger.flush();
+    
+    const VLCTSHitlessMerger::Stats& stats = merger.stats();
+    TEST_CHECK(stats.path[0].used == datagrams - 1);
+    TEST_CHECK(stats.path[1].used == 1);
+    TEST_CHECK(stats.path[1].redundant == datagrams - 1);
+    TEST_CHECK(merger.rtpStats().invalid == 1);
+    TEST_CHECK(lost == 0);
+    TEST_CHECK(out == ts.out);
+    return 0;
+}
+
+// One packet of PID 0x100 at position index; contentOf picks the payload
+static std::vector<uint8_t> tsPacket(int index, int contentOf) {
+    std::vector<uint8_t> packet(VLC_TS_PACKET_SIZE, 0);
+    packet[0] = VLC_TS_SYNC_BYTE;
+    packet[1] = 0x01;
+    packet[2] = 0x00;
+    packet[3] = (uint8_t)(0x10 | (index & 0x0F));
+    for (size_t i = 4; i < packet.size(); i++) packet[i] = (uint8_t)(contentOf * 7 + i);
+    return packet;
+}
+
+static int gapFillDrain() {
+    VLCTSHitlessMerger merger;
+    size_t out = 0;
+    uint64_t lost = 0;
+    merger.setPacketSink([&out](const uint8_t*, size_t count) { out += count; });
+    merger.setLossSink([&lost](uint64_t packets) { lost += packets; });
+    auto now = std::chrono::steady_clock::now();
+    
+    for (int i = 0; i <= 16; i++) {
+        std::vector<uint8_t> packet = tsPacket(i, i);
+        merger.pushTS(0, packet.data(), 1, now);
+        merger.pushTS(1, packet.data(), 1, now);
+    }
+    // Path 0 misses 17; 34 repeats 18 (same CC and payload) while it is held
+    for (int i = 18; i <= 36; i++) {
+        std::vector<uint8_t> packet = tsPacket(i, i == 34 ? 18 : i);
+        merger.pushTS(0, packet.data(), 1, now);
+    }
+    TEST_CHECK(out == 17);
+    std::vector<uint8_t> fill = tsPacket(17, 17);
+    merger.pushTS(1, fill.data(), 1, now);
+    merger.poll(now);
+    
+    // Everything but the repeat is out before the delay bound expires
+    TEST_CHECK(out == 36);
+    merger.flush();
+    TEST_CHECK(out == 36);
+    TEST_CHECK(lost == 0);
+    TEST_CHECK(merger.stats().lost == 0);
+    TEST_CHECK(merger.stats().gapFills >= 1);
+    return 0;
+}
+
+int main() {
+    if (corruptRTPCopy() != 0) return 1;
+    if (gapFillDrain() != 0) return 1;
+    printf("hitless_merger_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+// VLCTSParallelFileDemuxer::run() against runSequential(): the chunked pass
+// must emit exactly the frames of the single demuxer, in the same order,
+// including PTS-less frames and a duplicate packet on a chunk boundary.
+#include "tests/tsdemux_test_env.h"
+
+struct Emitted {
+    uint16_t pid;
+    uint64_t pts;
+    uint64_t packetIndex;
+    std::vector<uint8_t> data;
+    
+    bool operator==(const Emitted& other) const {
+        return pid == other.pid && pts == other.pts && packetIndex == other.packetIndex && data == other.data;
+    }
+};
+
+static std::vector<Emitted> demux(const std::vector<uint8_t>& ts, bool parallel, size_t chunkBytes) {
+    std::vector<Emitted> frames;
+    VLCTSParallelFileDemuxer demuxer(4, chunkBytes);
+    auto handler = [&frames](const VLCTSParallelFileDemuxer::Frame& frame) {
+        frames.push_back({ frame.pid, frame.header.pts, frame.packetIndex, frame.data });
+    };
+    if (parallel) {
+        demuxer.run(ts.data(), ts.size(), handler);
+    } else {
+        demuxer.runSequential(ts.data(), ts.size(), handler);
+    }
+    return frames;
+}
+
+// Interleaved video and audio; untimed drops the PTS/DTS of every PES
+static TestTSWriter stream(int units, bool untimed) {
+    TestTSWriter ts;
+    ts.writePSI();
+    for (int i = 0; i < units; i++) {
+        size_t at = ts.out.size();
+        if (i % 2 == 0) {
+            ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                        TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 20 == 0, 500));
+        } else {
+            ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, 90000 + i * 3000, TestTSWriter::adtsFrame(300));
+        }
+        if (untimed) {
+            uint8_t* packet = ts.out.data() + at;
+            size_t offset = (packet[3] & 0x20) ? 5 + packet[4] : 4;
+            packet[offset + 7] = 0x00;
+        }
+    }
+    return ts;
+}
+
+static int compare(const std::vector<uint8_t>& ts, size_t chunkBytes, size_t expectedFrames) {
+    std::vector<Emitted> sequential = demux(ts, false, 0);
+    std::vector<Emitted> parallel = demux(ts, true, chunkBytes);
+    TEST_CHECK(sequential.size() == expectedFrames);
+    TEST_CHECK(parallel.size() == sequential.size());
+    TEST_CHECK(parallel == sequential);
+    return 0;
+}
+
+int main() {
+    const int units = 400;
+    const size_t frames = units - 1;    // Nothing follows the last unit to close it
+    
+    for (bool untimed : { false, true }) {
+        TestTSWriter ts = stream(units, untimed);
+        if (compare(ts.out, VLC_TS_PACKET_SIZE * 64, frames) != 0) return 1;
+        if (compare(ts.out, VLC_TS_PACKET_SIZE * 100, frames) != 0) return 1;
+    }
+    
+    // Repeat a video unit start right after itself, with the copy opening a
+    // chunk: it is a duplicate, not a new frame, on both sides of the split
+    TestTSWriter ts = stream(units, false);
+    size_t packets = ts.packets();
+    size_t start = 0;
+    for (size_t i = 100; i < packets && !start; i++) {
+        const uint8_t* packet = ts.out.data() + i * VLC_TS_PACKET_SIZE;
+        uint16_t pid = ((packet[1] & 0x1F) << 8) | packet[2];
+        if (pid == TestTSWriter::VIDEO_PID && (packet[1] & 0x40)) start = i;
+    }
+    TEST_CHECK(start != 0);
+    std::vector<uint8_t> duplicated(ts.out.begin(), ts.out.begin() + (start + 1) * VLC_TS_PACKET_SIZE);
+    duplicated.insert(duplicated.end(), ts.out.begin() + start * VLC_TS_PACKET_SIZE, ts.out.end());
+    if (compare(duplicated, (start + 1) * VLC_TS_PACKET_SIZE, frames) != 0) return 1;
+    if (compare(duplicated, start * VLC_TS_PACKET_SIZE, frames) != 0) return 1;
+    
+    printf("parallel_file_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,84 @@
+// VLCTSShardedPipeline by program: PIDs seen before their PMT must still
+// end up on their program's shard, and never change shard, so per-PID
+// frames keep their order. A PID no PMT lists is released on its own.
+#include "tests/tsdemux_test_env.h"
+
+struct Emitted {
+    size_t shard;
+    uint16_t pid;
+    uint64_t pts;
+};
+
+static const uint16_t UNLISTED_PID = 0x1C0;
+
+static void writeUnits(TestTSWriter& ts, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        uint64_t pts = 90000 + i * 3000;
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, pts,
+                    TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 10 == 0));
+        ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, pts, TestTSWriter::adtsFrame());
+    }
+}
+
+static int run(const TestTSWriter& ts, std::vector<Emitted>& frames, VLCTSShardedPipeline::Stats& stats) {
+    std::mutex lock;
+    VLCTSShardedPipeline pipeline(2, VLCTSShardedPipeline::SHARD_BY_PROGRAM);
+    pipeline.setupShards([&](VLCTSDemuxer& demuxer, size_t shard) {
+        auto record = [&lock, &frames, shard](uint16_t pid, const uint8_t*, size_t, VLCPESHeader& header) {
+            std::lock_guard<std::mutex> guard(lock);
+            frames.push_back({ shard, pid, header.pts });
+        };
+        demuxer.setVideoCallback(record);
+        demuxer.setAudioCallback(record);
+    });
+    TEST_CHECK(pipeline.start());
+    pipeline.push(ts.out.data(), ts.packets());
+    pipeline.stop();
+    stats = pipeline.stats();
+    return 0;
+}
+
+int main() {
+    // Joined mid-stream: PES first, then PAT/PMT (program 1 goes to shard 0,
+    // while both ES PIDs are odd and would route to shard 1 on their own)
+    TestTSWriter ts;
+    writeUnits(ts, 0, 3);
+    ts.writePSI();
+    writeUnits(ts, 3, 30);
+    
+    std::vector<Emitted> frames;
+    VLCTSShardedPipeline::Stats stats;
+    if (run(ts, frames, stats) != 0) return 1;
+    
+    TEST_CHECK(stats.held > 0);
+    std::map<uint16_t, std::vector<uint64_t>> byPID;
+    for (const Emitted& frame : frames) {
+        TEST_CHECK(frame.shard == 0);
+        byPID[frame.pid].push_back(frame.pts);
+    }
+    TEST_CHECK(byPID[TestTSWriter::VIDEO_PID].size() >= 30);
+    TEST_CHECK(byPID[TestTSWriter::AUDIO_PID].size() >= 30);
+    for (const auto& entry : byPID) {
+        TEST_CHECK(std::is_sorted(entry.second.begin(), entry.second.end()));
+    }
+    
+    // Audio on a PID no PMT lists: held, then routed by PID (0x1C0 -> shard 0)
+    // once the hold is full, and auto-detected by that shard
+    TestTSWriter unlisted;
+    unlisted.writePSI();
+    for (int i = 0; i < 100; i++) {
+        unlisted.writePES(UNLISTED_PID, 0xC0, 90000 + i * 1920, TestTSWriter::adtsFrame());
+    }
+    frames.clear();
+    if (run(unlisted, frames, stats) != 0) return 1;
+    TEST_CHECK(stats.held >= 64);
+    TEST_CHECK(frames.size() >= 99);
+    for (size_t i = 0; i < frames.size(); i++) {
+        TEST_CHECK(frames[i].pid == UNLISTED_PID);
+        TEST_CHECK(frames[i].shard == frames[0].shard);
+        TEST_CHECK(i == 0 || frames[i].pts > frames[i - 1].pts);
+    }
+    
+    printf("sharded_program_test: ok\n");
+    return 0;
+}
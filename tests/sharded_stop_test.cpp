@@ -0,0 +1,62 @@
+// Ordered VLCTSShardedPipeline: stop() and the destructor must return while
+// nobody polls and the output queues are full.
+#include "tests/tsdemux_test_env.h"
+
+static std::vector<uint8_t> makeStream(size_t frames) {
+    TestTSWriter ts;
+    ts.writePSI();
+    for (size_t i = 0; i < frames; i++) {
+        uint64_t pts = 90000 + i * 3000;
+        if (i % 2 == 0) {
+            ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, pts,
+                        TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, true));
+        } else {
+            ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, pts, TestTSWriter::adtsFrame());
+        }
+    }
+    return ts.out;
+}
+
+int main() {
+    // A hang is the failure mode: give up loudly instead
+    std::thread([] {
+        std::this_thread::sleep_for(std::chrono::seconds(20));
+        fprintf(stderr, "sharded_stop_test: timed out\n");
+        _exit(1);
+    }).detach();
+    
+    const size_t frames = 40;
+    std::vector<uint8_t> stream = makeStream(frames);
+    size_t packets = stream.size() / VLC_TS_PACKET_SIZE;
+    
+    // Single-threaded caller: push everything, stop, then poll
+    {
+        VLCTSShardedPipeline pipeline(2, VLCTSShardedPipeline::SHARD_BY_PID, true, 8192, 4);
+        TEST_CHECK(pipeline.start());
+        pipeline.push(stream.data(), packets);
+        pipeline.stop();
+        
+        size_t delivered = 0;
+        uint64_t lastDts = 0;
+        bool ordered = true;
+        pipeline.pollOrdered([&](const VLCTSShardedPipeline::OrderedFrame& frame) {
+            ordered = ordered && frame.header.dts >= lastDts;
+            lastDts = frame.header.dts;
+            delivered++;
+        });
+        // The last PES of each PID stays open without a following PUSI
+        TEST_CHECK(delivered >= frames - 2);
+        TEST_CHECK(ordered);
+    }
+    
+    // Destroyed with full output queues and no poller at all
+    {
+        VLCTSShardedPipeline pipeline(2, VLCTSShardedPipeline::SHARD_BY_PID, true, 8192, 4);
+        TEST_CHECK(pipeline.start());
+        pipeline.push(stream.data(), packets);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    
+    printf("sharded_stop_test: ok\n");
+    return 0;
+}
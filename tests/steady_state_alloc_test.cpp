@@ -0,0 +1,80 @@
+// Steady-state demuxing allocates nothing: once a mixed H.264/audio stream
+// has been seen, further packets with a subscriber and a frame queue
+// attached take no memory from the demuxer's resource or the global heap.
+#include "tests/tsdemux_test_env.h"
+#include <new>
+
+static std::atomic<uint64_t> gAllocations{0};
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Frame sizes vary so the frame pool has to serve several size classes
+static std::vector<uint8_t> stream(int from, int to) {
+    TestTSWriter ts;
+    for (int i = from; i < to; i++) {
+        if (i % 25 == 0) ts.writePSI();
+        ts.writePES(TestTSWriter::VIDEO_PID, 0xE0, 90000 + i * 3000,
+                    TestTSWriter::accessUnit({ TestTSWriter::sps(), TestTSWriter::pps() }, i % 30 == 0,
+                                             300 + (i * 37) % 3000));
+        ts.writePES(TestTSWriter::AUDIO_PID, 0xC0, 90000 + i * 1920, TestTSWriter::adtsFrame(200));
+    }
+    return ts.out;
+}
+
+int main() {
+    const std::vector<uint8_t> warm = stream(0, 200);
+    const std::vector<uint8_t> steady = stream(200, 400);
+    
+    VLCTSCountingResource counting;
+    VLCTSDemuxer demuxer(&counting);
+    VLCTSFrameQueue queue(256, 4 * 1024 * 1024);
+    demuxer.setFrameQueue(&queue);
+    size_t frames = 0;
+    size_t subscribed = 0;
+    size_t queued = 0;
+    demuxer.setVideoCallback([&frames](uint16_t, const uint8_t*, size_t, VLCPESHeader&) { frames++; });
+    demuxer.setAudioCallback([&frames](uint16_t, const uint8_t*, size_t, VLCPESHeader&) { frames++; });
+    demuxer.subscribe([&subscribed](const VLCTSFrameRef&) { subscribed++; });
+    
+    // Fed in datagram-sized runs; the queue is drained between runs
+    auto feed = [&](const std::vector<uint8_t>& ts) {
+        const size_t run = 7;
+        size_t packets = ts.size() / VLC_TS_PACKET_SIZE;
+        for (size_t i = 0; i < packets; i += run) {
+            demuxer.demuxPackets(ts.data() + i * VLC_TS_PACKET_SIZE, std::min(run, packets - i));
+            VLCTSFrameQueue::Frame frame;
+            while (queue.front(frame, 0)) {
+                queued++;
+                queue.pop();
+            }
+        }
+    };
+    
+    feed(warm);
+    TEST_CHECK(frames > 0 && subscribed > 0 && queued > 0);
+    size_t framesBefore = frames;
+    size_t subscribedBefore = subscribed;
+    size_t queuedBefore = queued;
+    uint64_t resourceBefore = counting.allocations();
+    uint64_t heapBefore = gAllocations.load();
+    
+    feed(steady);
+    uint64_t resourceAllocations = counting.allocations() - resourceBefore;
+    uint64_t heapAllocations = gAllocations.load() - heapBefore;
+    TEST_CHECK(frames - framesBefore >= 199);
+    TEST_CHECK(subscribed - subscribedBefore >= 199);
+    TEST_CHECK(queued - queuedBefore >= 199);
+    TEST_CHECK(resourceAllocations == 0);
+    TEST_CHECK(heapAllocations == 0);
+    
+    printf("steady_state_alloc_test: ok (%zu frames)\n", frames - framesBefore);
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ **  tsdemux_test_env.h - host stand-ins and a minimal TS muxer for the tests
+ **
+ **  tsdemux.h is included into an application that provides VT_FrameInfo,
+ **  SceneDelegate and CFAbsoluteTimeGetCurrent(); the tests supply small
+ **  stand-ins. Build a test with e.g.
+ **      c++ -std=c++17 -O2 -pthread -I. tests/sharded_stop_test.cpp
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <set>
+#include <list>
+#include <deque>
+#include <array>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#define VT_MAGIC 0x56544649
+
+struct VT_FrameInfo {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t sequence;
+    bool isKeyFrame;
+    double cts;
+    double dts;
+    double duration;
+    double fps;
+    uint32_t width;
+    uint32_t height;
+    uint32_t timeScale;
+    uint32_t spSize;
+    uint32_t ppSize;
+};
+
+struct TestRingBuffer {
+    size_t FreeSpace() const { return SIZE_MAX; }
+    void WriteData(const void*, size_t) {}
+};
+
+struct TestSceneDelegate {
+    TestRingBuffer* videoRingBuffer = nullptr;
+    TestRingBuffer* audioRingBuffer = nullptr;
+};
+
+inline TestSceneDelegate SceneDelegate;
+
+inline double CFAbsoluteTimeGetCurrent() {
+    using namespace std::chrono;
+    return duration<double>(system_clock::now().time_since_epoch()).count();
+}
+
+#include "tsdemux.h"
+
+#define TEST_CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+} while (0)
+
+// Packetizes PSI and PES into 188-byte packets: one program (PMT on 0x100)
+// with H.264 (or the given type of) video on 0x101 and AAC audio on 0x102
+class TestTSWriter {
+public:
+    static constexpr uint16_t PMT_PID = 0x100;
+    static constexpr uint16_t VIDEO_PID = 0x101;
+    static constexpr uint16_t AUDIO_PID = 0x102;
+    
+    std::vector<uint8_t> out;
+    
+    size_t packets() const { return out.size() / VLC_TS_PACKET_SIZE; }
+    
+    void writePSI(uint8_t videoType = VLC_STREAM_TYPE_VIDEO_H264) {
+        static const uint8_t pat[] = {
+            0x00, 0xB0, 0x0D, 0x00, 0x01, 0xC1, 0x00, 0x00,
+            0x00, 0x01, 0xE0 | (PMT_PID >> 8), PMT_PID & 0xFF
+        };
+        const uint8_t pmt[] = {
+            0x02, 0xB0, 0x17, 0x00, 0x01, 0xC1, 0x00, 0x00,
+            0xE0 | (VIDEO_PID >> 8), VIDEO_PID & 0xFF, 0xF0, 0x00,
+            videoType, 0xE0 | (VIDEO_PID >> 8), VIDEO_PID & 0xFF, 0xF0, 0x00,
+            VLC_STREAM_TYPE_AUDIO_AAC, 0xE0 | (AUDIO_PID >> 8), AUDIO_PID & 0xFF, 0xF0, 0x00
+        };
+        writeSection(VLC_TS_PAT_PID, pat, sizeof(pat));
+        writeSection(PMT_PID, pmt, sizeof(pmt));
+    }
+    
+    // Writes one PES with PTS and DTS; an empty payload gets a filler frame
+    void writePES(uint16_t pid, uint8_t streamId, uint64_t pts, const std::vector<uint8_t>& payload) {
+        std::vector<uint8_t> pes = {
+            0x00, 0x00, 0x01, streamId, 0x00, 0x00, 0x80, 0xC0, 0x0A
+        };
+        appendTimestamp(pes, 0x30, pts);
+        appendTimestamp(pes, 0x10, pts);
+        pes.insert(pes.end(), payload.begin(), payload.end());
+        if (streamId != 0xE0) {
+            size_t length = pes.size() - 6;
+            pes[4] = (uint8_t)(length >> 8);
+            pes[5] = (uint8_t)length;
+        }
+        writePayload(pid, pes.data(), pes.size());
+    }
+    
+    // An Annex B access unit: AUD, then the given NALs, then a slice
+    static std::vector<uint8_t> accessUnit(const std::vector<std::vector<uint8_t>>& nals, bool idr,
+                                           size_t sliceBytes = 300) {
+        std::vector<uint8_t> au = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+        for (const auto& nal : nals) {
+            au.insert(au.end(), { 0x00, 0x00, 0x00, 0x01 });
+            au.insert(au.end(), nal.begin(), nal.end());
+        }
+        au.insert(au.end(), { 0x00, 0x00, 0x00, 0x01, (uint8_t)(idr ? 0x65 : 0x41), 0x88 });
+        for (size_t i = 0; i < sliceBytes; i++) {
+            au.push_back((uint8_t)(0x10 + i % 0xE0));   // Never forms a start code
+        }
+        return au;
+    }
+    
+    // 320x240 baseline SPS and a matching PPS
+    static std::vector<uint8_t> sps() {
+        return { 0x67, 0x42, 0xC0, 0x1E, 0xDA, 0x05, 0x07, 0xE8, 0x40, 0x00, 0x00, 0x03, 0x00, 0x40,
+                 0x00, 0x00, 0x0C, 0x83, 0xC5, 0x8B, 0xA8 };
+    }
+    static std::vector<uint8_t> pps() {
+        return { 0x68, 0xCE, 0x3C, 0x80 };
+    }
+    
+    // ADTS AAC frame of the given total size
+    static std::vector<uint8_t> adtsFrame(size_t size = 64) {
+        std::vector<uint8_t> frame = {
+            0xFF, 0xF1, 0x50, 0x80, (uint8_t)((size >> 3) & 0xFF), (uint8_t)(((size & 7) << 5) | 0x1F), 0xFC
+        };
+        frame.resize(size, 0x21);
+        return frame;
+    }
+    
+    void writeNull() {
+        uint8_t packet[VLC_TS_PACKET_SIZE];
+        memset(packet, 0xFF, sizeof(packet));
+        packet[0] = VLC_TS_SYNC_BYTE;
+        packet[1] = 0x1F;
+        packet[2] = 0xFF;
+        packet[3] = 0x10;
+        out.insert(out.end(), packet, packet + VLC_TS_PACKET_SIZE);
+    }
+    
+private:
+    std::map<uint16_t, uint8_t> mCC;
+    
+    static void appendTimestamp(std::vector<uint8_t>& out, uint8_t prefix, uint64_t ts) {
+        out.push_back((uint8_t)(prefix | ((ts >> 29) & 0x0E) | 1));
+        out.push_back((uint8_t)(ts >> 22));
+        out.push_back((uint8_t)(((ts >> 14) & 0xFE) | 1));
+        out.push_back((uint8_t)(ts >> 7));
+        out.push_back((uint8_t)(((ts << 1) & 0xFE) | 1));
+    }
+    
+    static uint32_t crc32(const uint8_t* data, size_t size) {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < size; i++) {
+            crc ^= (uint32_t)data[i] << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+            }
+        }
+        return crc;
+    }
+    
+    void writeSection(uint16_t pid, const uint8_t* section, size_t size) {
+        std::vector<uint8_t> data(1, 0x00);     // pointer_field
+        data.insert(data.end(), section, section + size);
+        uint32_t crc = crc32(section, size);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            data.push_back((uint8_t)(crc >> shift));
+        }
+        writePayload(pid, data.data(), data.size(), 0xFF);
+    }
+    
+    // Splits data over packets; the last one is padded with adaptation-field
+    // stuffing (or with fill bytes for sections)
+    void writePayload(uint16_t pid, const uint8_t* data, size_t size, int fill = -1) {
+        bool first = true;
+        while (size > 0 || first) {
+            uint8_t packet[VLC_TS_PACKET_SIZE];
+            size_t room = VLC_TS_PACKET_SIZE - 4;
+            size_t take = std::min(size, room);
+            size_t stuffing = (fill < 0 && take < room) ? room - take : 0;
+            
+            packet[0] = VLC_TS_SYNC_BYTE;
+            packet[1] = (uint8_t)((first ? 0x40 : 0x00) | (pid >> 8));
+            packet[2] = (uint8_t)pid;
+            packet[3] = (uint8_t)((stuffing ? 0x30 : 0x10) | (mCC[pid]++ & 0x0F));
+            
+            size_t offset = 4;
+            if (stuffing) {
+                packet[4] = (uint8_t)(stuffing - 1);
+                if (stuffing > 1) {
+                    packet[5] = 0x00;
+                    memset(packet + 6, 0xFF, stuffing - 2);
+                }
+                offset += stuffing;
+            }
+            memcpy(packet + offset, data, take);
+            if (offset + take < VLC_TS_PACKET_SIZE) {
+                memset(packet + offset + take, fill < 0 ? 0xFF : fill, VLC_TS_PACKET_SIZE - offset - take);
+            }
+            out.insert(out.end(), packet, packet + VLC_TS_PACKET_SIZE);
+            
+            data += take;
+            size -= take;
+            first = false;
+        }
+    }
+};